@@ -30,6 +30,7 @@
 // defines:
 //   PARMPARS_EXIT_ON_WARNING
 //   PARMPARS_USE_REGEX
+//   PARMPARS_NO_SIMD
 
 // TODO : cache parsed variable values (?)
 // TODO : add inline (?)
@@ -44,16 +45,68 @@
 #include <iostream>
 #include <cstdlib>
 #include <cctype>
+#include <cmath>
 #include <map>
+#include <fstream>
+#include <functional>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <initializer_list>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/wait.h>
+#endif
 
 #ifdef _TESTLIB_H_
 	#define USE_TESTLIB
 #endif
 
+#if !defined(PARMPARS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+	#include <emmintrin.h>
+	#define PARMPARS_SSE2
+#endif
+
 namespace ParmParsInternal {
 
 const long double eps = 1e-12;
 
+namespace Json {
+	inline std::string quote(const std::string &str) {
+		std::string res = "\"";
+		for (char c: str) {
+			switch (c) {
+				case '"': res += "\\\""; break;
+				case '\\': res += "\\\\"; break;
+				case '\n': res += "\\n"; break;
+				case '\t': res += "\\t"; break;
+				default: {
+					if (static_cast<unsigned char>(c) < ' ') {
+						char buf[8];
+						std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+						res += buf;
+					} else {
+						res += c;
+					}
+				}
+			}
+		}
+		return res + "\"";
+	}
+}
+
+
 namespace Alerts {
 	enum class Severity {
 		Error,
@@ -69,6 +122,148 @@ namespace Alerts {
 	
 	bool hadError = false;
 	
+	struct Alert {
+		Severity severity;
+		std::string varName;
+		int paramNumber;  // 0 if the alert isn't related to a parameter
+		std::string text;
+	};
+	
+	struct Context {
+		std::string varName;
+		int paramNumber;
+	};
+	
+	// Variable which is being processed now. Alerts raised meanwhile are
+	// attributed to it
+	Context context {"", 0};
+	
+	class ScopedContext {
+	private:
+		Context saved_;
+	public:
+		ScopedContext(const std::string &varName, int paramNumber)
+			: saved_(context) {
+			context = Context {varName, paramNumber};
+		}
+		
+		~ScopedContext() {
+			context = saved_;
+		}
+	};
+	
+	// Collects the alerts in memory and writes them to stderr at once, either
+	// as text or as JSON lines. In "collect errors" mode, the errors raised
+	// while a parameter is processed don't stop the program until
+	// failOnErrors() is called, so all of them are shown
+	class Sink {
+	private:
+		std::vector<Alert> alerts_;
+		bool json_ = false;
+		bool collectErrors_ = false;
+		// In script check mode, the alerts for a line of the script are
+		// written to the parent process
+		int scriptLine_ = 0;
+		FILE *scriptOut_ = nullptr;
+		
+		static bool isEnvSet(const char *name, const char *value = nullptr) {
+			const char *env = std::getenv(name);
+			if (env == nullptr || *env == '\0') {
+				return false;
+			}
+			return value == nullptr ? std::string(env) != "0" : std::string(env) == value;
+		}
+	public:
+		bool collectErrors() const {
+			return collectErrors_;
+		}
+		
+		void setCollectErrors(bool collectErrors) {
+			collectErrors_ = collectErrors;
+		}
+		
+		void setJson(bool json) {
+			json_ = json;
+		}
+		
+		void setScriptLine(int scriptLine, FILE *scriptOut) {
+			scriptLine_ = scriptLine;
+			scriptOut_ = scriptOut;
+		}
+		
+		const std::vector<Alert> &alerts() const {
+			return alerts_;
+		}
+		
+		void add(const Alert &alert) {
+			alerts_.push_back(alert);
+		}
+		
+		void flush() {
+			if (alerts_.empty()) {
+				return;
+			}
+			std::string res;
+			for (const Alert &alert: alerts_) {
+				if (scriptOut_ != nullptr || json_) {
+					std::string severity = names[static_cast<int>(alert.severity)];
+					severity[0] = std::tolower(severity[0]);
+					res += "{";
+					if (scriptOut_ != nullptr) {
+						res += "\"line\": " + std::to_string(scriptLine_) + ", ";
+					}
+					res += "\"severity\": " + Json::quote(severity);
+					res += ", \"variable\": " + (alert.varName.empty() ? "null" : Json::quote(alert.varName));
+					if (scriptOut_ == nullptr) {
+						res += ", \"param\": " + (alert.paramNumber == 0 ? "null" : std::to_string(alert.paramNumber));
+					}
+					res += ", \"message\": " + Json::quote(alert.text) + "}\n";
+				} else {
+					res += names[static_cast<int>(alert.severity)];
+					res += ": " + alert.text + "\n";
+				}
+			}
+			alerts_.clear();
+			if (scriptOut_ != nullptr) {
+				std::fwrite(res.data(), 1, res.size(), scriptOut_);
+				std::fflush(scriptOut_);
+				return;
+			}
+			std::cerr << res;
+			std::cerr.flush();
+		}
+		
+		Sink() {
+			#ifdef PARMPARS_COLLECT_ERRORS
+				collectErrors_ = true;
+			#endif
+			#ifdef PARMPARS_JSON_DIAGNOSTICS
+				json_ = true;
+			#endif
+			collectErrors_ |= isEnvSet("PARMPARS_COLLECT_ERRORS");
+			json_ |= isEnvSet("PARMPARS_DIAGNOSTICS", "json");
+		}
+		
+		~Sink() {
+			flush();
+			if (hadError && collectErrors_) {
+				std::_Exit(1);
+			}
+		}
+	};
+	
+	Sink sink;
+	
+	// Shows the collected alerts and exits if there were errors. After this
+	// call, the errors stop the program immediately
+	void failOnErrors() {
+		sink.setCollectErrors(false);
+		sink.flush();
+		if (hadError) {
+			exit(1);
+		}
+	}
+	
 	void processAlert(Severity severity) {
 		bool mustExit = severity == Severity::Error;
 		#ifdef PARMPARS_EXIT_ON_WARNING
@@ -76,12 +271,19 @@ namespace Alerts {
 		#endif
 		if (mustExit) {
 			hadError = true;
+			// Other errors (e.g. in the generators) stop the program even in
+			// "collect errors" mode, as the code after them cannot continue
+			bool inParameter = !context.varName.empty() || context.paramNumber != 0;
+			if (sink.collectErrors() && inParameter) {
+				return;
+			}
+			sink.flush();
 			exit(1);
 		}
 	}
 	
 	void showAlert(Severity severity, const std::string &text) {
-		std::cerr << names[static_cast<int>(severity)] << ": " << text << std::endl;
+		sink.add(Alert {severity, context.varName, context.paramNumber, text});
 	}
 	
 	void raiseAlert(Severity severity, const std::string &text) {
@@ -113,6 +315,17 @@ public:
 		return *this;
 	}
 	
+	template<typename T>
+	StringBuilder &operator<<(const std::vector<T> &value) {
+		for (size_t i = 0; i < value.size(); ++i) {
+			if (i != 0) {
+				stream << ",";
+			}
+			*this << value[i];
+		}
+		return *this;
+	}
+	
 	operator std::string() const {
 		return stream.str();
 	}
@@ -136,10 +349,14 @@ isRangeValid(const Range<T> &res) {
 	return res.left <= res.right;
 }
 
+// Set in schema and script check modes. The ranges built from the placeholder
+// values may be empty then, which is not an error
+bool placeholderValues = false;
+
 template<typename T>
 Range<T> range(const T &left, const T &right) {
 	Range<T> res {left, right};
-	if (!isRangeValid(res)) {
+	if (!isRangeValid(res) && !placeholderValues) {
 		Alerts::error(StringBuilder()
 			<< "Range [" << left << "; " << right << "] is invalid!"
 		);
@@ -174,44 +391,453 @@ struct InRange<T, T, typename std::enable_if<std::is_floating_point<T>::value>::
 };
 
 
+// Parser for the simple regexes, which are concatenations of character classes
+// or single characters with optional counts, like "[a-z]{1,10}x[0-9]?". Such
+// patterns can be processed faster than in the general case. Anything else
+// (alternations, groups, negated classes, etc.) is not recognized
+namespace SimpleRegex {
+	struct Item {
+		std::vector<char> chars;
+		int from, to;
+	};
+	
+	inline bool isSpecialChar(char c) {
+		return std::strchr("()|[]{}*+?.^$\\", c) != nullptr;
+	}
+	
+	// Reads a char which may be escaped with '\'. Only punctuation may be
+	// escaped, as sequences like "\d" have special meaning
+	inline bool readChar(const std::string &re, size_t &pos, char &c) {
+		if (pos >= re.size()) {
+			return false;
+		}
+		if (re[pos] != '\\') {
+			c = re[pos++];
+			return c > ' ' && c != 127;
+		}
+		if (pos + 1 >= re.size()) {
+			return false;
+		}
+		c = re[pos+1];
+		if (!std::ispunct(static_cast<unsigned char>(c))) {
+			return false;
+		}
+		pos += 2;
+		return true;
+	}
+	
+	inline bool readNumber(const std::string &re, size_t &pos, int &value) {
+		size_t start = pos;
+		long long res = 0;
+		while (pos < re.size() && std::isdigit(static_cast<unsigned char>(re[pos]))) {
+			res = res * 10 + (re[pos++] - '0');
+			if (res > INT_MAX - 1) {
+				return false;
+			}
+		}
+		value = res;
+		return pos != start;
+	}
+	
+	inline bool readClass(const std::string &re, size_t &pos, std::vector<char> &chars) {
+		// pos points after '['
+		if (pos < re.size() && (re[pos] == '^' || re[pos] == '-')) {
+			return false;
+		}
+		while (pos < re.size() && re[pos] != ']') {
+			if (re[pos] == '[') {
+				return false;
+			}
+			char left;
+			if (!readChar(re, pos, left)) {
+				return false;
+			}
+			if (pos < re.size() && re[pos] == '-') {
+				++pos;
+				char right;
+				if (pos >= re.size() || re[pos] == ']' || !readChar(re, pos, right) || left > right) {
+					return false;
+				}
+				for (int c = left; c <= right; ++c) {
+					chars.push_back(c);
+				}
+			} else {
+				chars.push_back(left);
+			}
+		}
+		if (pos >= re.size() || chars.empty()) {
+			return false;
+		}
+		++pos;
+		std::sort(chars.begin(), chars.end());
+		return std::adjacent_find(chars.begin(), chars.end()) == chars.end();
+	}
+	
+	inline bool readCounts(const std::string &re, size_t &pos, int &from, int &to) {
+		from = to = 1;
+		if (pos >= re.size()) {
+			return true;
+		}
+		switch (re[pos]) {
+			case '?': {
+				++pos;
+				from = 0;
+				return true;
+			}
+			case '*': {
+				++pos;
+				from = 0;
+				to = INT_MAX;
+				return true;
+			}
+			case '+': {
+				++pos;
+				to = INT_MAX;
+				return true;
+			}
+			case '{': {
+				++pos;
+				if (!readNumber(re, pos, from)) {
+					return false;
+				}
+				to = from;
+				if (pos < re.size() && re[pos] == ',') {
+					++pos;
+					if (!readNumber(re, pos, to) || from > to) {
+						return false;
+					}
+				}
+				if (pos >= re.size() || re[pos] != '}') {
+					return false;
+				}
+				++pos;
+				return true;
+			}
+		}
+		return true;
+	}
+	
+	inline bool parse(const std::string &re, std::vector<Item> &items) {
+		items.clear();
+		size_t pos = 0;
+		while (pos < re.size()) {
+			Item item;
+			if (re[pos] == '[') {
+				++pos;
+				if (!readClass(re, pos, item.chars)) {
+					return false;
+				}
+			} else {
+				char c;
+				if (isSpecialChar(re[pos]) && re[pos] != '\\') {
+					return false;
+				}
+				if (!readChar(re, pos, c)) {
+					return false;
+				}
+				item.chars.push_back(c);
+			}
+			if (!readCounts(re, pos, item.from, item.to)) {
+				return false;
+			}
+			items.push_back(item);
+		}
+		return true;
+	}
+	
+	class CharClass {
+	private:
+		bool table_[256];
+		std::vector<std::pair<unsigned char, unsigned char>> ranges_;
+	public:
+		bool contains(char c) const {
+			return table_[static_cast<unsigned char>(c)];
+		}
+		
+		bool intersects(const CharClass &other) const {
+			for (int c = 0; c < 256; ++c) {
+				if (table_[c] && other.table_[c]) {
+					return true;
+				}
+			}
+			return false;
+		}
+		
+		// Returns the length of the longest prefix of data which consists
+		// only of the chars from the class
+		size_t matchPrefix(const char *data, size_t size) const {
+			size_t pos = 0;
+			#ifdef PARMPARS_SSE2
+			const size_t maxRanges = 4;
+			if (ranges_.size() <= maxRanges) {
+				__m128i lefts[maxRanges], widths[maxRanges];
+				size_t rangeCount = ranges_.size();
+				for (size_t i = 0; i < rangeCount; ++i) {
+					lefts[i] = _mm_set1_epi8(static_cast<char>(ranges_[i].first));
+					widths[i] = _mm_set1_epi8(static_cast<char>(ranges_[i].second - ranges_[i].first));
+				}
+				for (; pos + 16 <= size; pos += 16) {
+					__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+					__m128i found = _mm_setzero_si128();
+					for (size_t i = 0; i < rangeCount; ++i) {
+						// c is in [left; left + width] iff (c - left) as unsigned is <= width
+						__m128i diff = _mm_sub_epi8(block, lefts[i]);
+						found = _mm_or_si128(found, _mm_cmpeq_epi8(_mm_max_epu8(diff, widths[i]), widths[i]));
+					}
+					if (_mm_movemask_epi8(found) != 0xffff) {
+						break;
+					}
+				}
+			}
+			#endif
+			while (pos < size && contains(data[pos])) {
+				++pos;
+			}
+			return pos;
+		}
+		
+		explicit CharClass(const std::vector<char> &chars) {
+			std::fill(table_, table_ + 256, false);
+			for (char c: chars) {
+				table_[static_cast<unsigned char>(c)] = true;
+			}
+			for (int c = 0; c < 256;) {
+				if (!table_[c]) {
+					++c;
+					continue;
+				}
+				int left = c;
+				while (c < 256 && table_[c]) {
+					++c;
+				}
+				ranges_.emplace_back(left, c - 1);
+			}
+		}
+	};
+	
+	// Matches the whole value against the simple pattern. Returns false if the
+	// pattern is not simple or cannot be matched greedily, i. e. each item must
+	// be disjoint with all the items which can directly follow it
+	inline bool tryMatch(const std::string &re, const char *data, size_t size, bool &matches) {
+		std::vector<Item> items;
+		if (!parse(re, items)) {
+			return false;
+		}
+		std::vector<CharClass> classes;
+		classes.reserve(items.size());
+		for (const Item &item: items) {
+			classes.emplace_back(item.chars);
+		}
+		for (size_t i = 0; i < items.size(); ++i) {
+			for (size_t j = i+1; j < items.size(); ++j) {
+				if (classes[i].intersects(classes[j])) {
+					return false;
+				}
+				if (items[j].from != 0) {
+					break;
+				}
+			}
+		}
+		size_t pos = 0;
+		for (size_t i = 0; i < items.size(); ++i) {
+			size_t count = classes[i].matchPrefix(data + pos, size - pos);
+			if (count < static_cast<size_t>(items[i].from) || count > static_cast<size_t>(items[i].to)) {
+				matches = false;
+				return true;
+			}
+			pos += count;
+		}
+		matches = pos == size;
+		return true;
+	}
+}
+
+
+// Set of the allowed values. The values are sorted once, so each check takes
+// O(log n). Copies share the same storage
+template<typename T>
+class OneOf {
+private:
+	std::shared_ptr<const std::vector<T>> values_;
+public:
+	const std::vector<T> &values() const {
+		return *values_;
+	}
+	
+	template<typename V>
+	bool contains(const V &value) const {
+		return std::binary_search(values_->begin(), values_->end(), value);
+	}
+	
+	explicit OneOf(std::vector<T> values) {
+		if (values.empty()) {
+			Alerts::error("The set of allowed values is empty!");
+		}
+		std::sort(values.begin(), values.end());
+		values.erase(std::unique(values.begin(), values.end()), values.end());
+		values_ = std::make_shared<const std::vector<T>>(std::move(values));
+	}
+};
+
+template<typename T>
+struct OneOfValue {
+	typedef T type;
+};
+
+template<>
+struct OneOfValue<char *> {
+	typedef std::string type;
+};
+
+template<>
+struct OneOfValue<const char *> {
+	typedef std::string type;
+};
+
+template<typename T, typename... Args>
+OneOf<typename OneOfValue<typename std::decay<T>::type>::type>
+oneOf(const T &first, const Args &... rest) {
+	typedef typename OneOfValue<typename std::decay<T>::type>::type ValueType;
+	return OneOf<ValueType>(std::vector<ValueType> {ValueType(first), ValueType(rest)...});
+}
+
+template<typename T>
+OneOf<typename OneOfValue<T>::type> oneOf(std::initializer_list<T> values) {
+	typedef typename OneOfValue<T>::type ValueType;
+	return OneOf<ValueType>(std::vector<ValueType>(values.begin(), values.end()));
+}
+
+template<typename T>
+OneOf<typename OneOfValue<T>::type> oneOf(const std::vector<T> &values) {
+	typedef typename OneOfValue<T>::type ValueType;
+	return OneOf<ValueType>(std::vector<ValueType>(values.begin(), values.end()));
+}
+
+
+// Each specialization provides two methods:
+//   check() returns the error message or an empty string if the value is valid
+//   describe() returns the validation as a JSON value, used for the schema
 template<typename T, typename Enable, typename...> struct DataValidate {};
 
 template<typename T, typename... ValidateMeans>
 void dataValidate(const char *varName, const T &value, ValidateMeans... means) {
-	DataValidate<T, void, ValidateMeans...>::doIt(varName, value, means...);
+	std::string message = DataValidate<T, void, ValidateMeans...>::check(varName, value, means...);
+	if (!message.empty()) {
+		Alerts::error(message);
+	}
 }
 
 template<typename T>
 struct DataValidate<T, void> {
-	static void doIt(const char *, const T &) {}
+	static std::string check(const char *, const T &) {
+		return "";
+	}
+	
+	static std::string describe() {
+		return "null";
+	}
 };
 
+template<typename T>
+struct IsVector : std::false_type {};
+
+template<typename T>
+struct IsVector<std::vector<T>> : std::true_type {};
+
 template<typename T, typename R>
-struct DataValidate<T, void, Range<R>> {
-	static void doIt(const char *varName, const T &value, const Range<R> &range) {
+struct DataValidate<T, typename std::enable_if<!IsVector<T>::value>::type, Range<R>> {
+	static std::string check(const char *varName, const T &value, const Range<R> &range) {
 		if (!inRange(range, value)) {
-			Alerts::error(StringBuilder()
+			return StringBuilder()
 				<< varName << " = " << value << " is not in the range "
-				<< "[" << range.left << "; " << range.right << "]"
-			);
+				<< "[" << range.left << "; " << range.right << "]";
+		}
+		return "";
+	}
+	
+	static std::string describe(const Range<R> &range) {
+		return StringBuilder()
+			<< "{\"kind\": \"range\", "
+			<< "\"left\": " << Json::quote(StringBuilder() << range.left) << ", "
+			<< "\"right\": " << Json::quote(StringBuilder() << range.right) << "}";
+	}
+};
+
+template<typename T, typename U>
+struct DataValidate<T, typename std::enable_if<!IsVector<T>::value>::type, OneOf<U>> {
+	static std::string check(const char *varName, const T &value, const OneOf<U> &oneOf) {
+		if (!oneOf.contains(value)) {
+			StringBuilder res;
+			res << varName << " = " << value << " is not one of the allowed values {";
+			const std::vector<U> &values = oneOf.values();
+			const size_t maxShown = 10;
+			for (size_t i = 0; i < values.size() && i < maxShown; ++i) {
+				res << (i == 0 ? "" : ", ") << values[i];
+			}
+			if (values.size() > maxShown) {
+				res << ", ... (" << values.size() << " values)";
+			}
+			return res << "}";
 		}
+		return "";
+	}
+	
+	static std::string describe(const OneOf<U> &oneOf) {
+		StringBuilder res;
+		res << "{\"kind\": \"oneOf\", \"values\": [";
+		const std::vector<U> &values = oneOf.values();
+		for (size_t i = 0; i < values.size(); ++i) {
+			res << (i == 0 ? "" : ", ") << Json::quote(StringBuilder() << values[i]);
+		}
+		return res << "]}";
+	}
+};
+
+// Validations for vectors are applied to each element
+template<typename T, typename ValidateMean>
+struct DataValidate<std::vector<T>, void, ValidateMean> {
+	static std::string check(const char *varName, const std::vector<T> &value, const ValidateMean &mean) {
+		for (size_t i = 0; i < value.size(); ++i) {
+			std::string elemName = StringBuilder() << varName << "[" << i << "]";
+			std::string message = DataValidate<T, void, ValidateMean>::check(elemName.c_str(), value[i], mean);
+			if (!message.empty()) {
+				return message;
+			}
+		}
+		return "";
+	}
+	
+	static std::string describe(const ValidateMean &mean) {
+		return DataValidate<T, void, ValidateMean>::describe(mean);
 	}
 };
 
 #if defined(PARMPARS_USE_REGEX) || defined(USE_TESTLIB)
+inline bool regexMatches(const char *data, size_t size, const std::string &re) {
+	bool res;
+	if (SimpleRegex::tryMatch(re, data, size, res)) {
+		return res;
+	}
+	#ifdef PARMPARS_USE_REGEX
+	return std::regex_match(data, data + size, std::regex(re));
+	#else
+	return pattern(re).matches(std::string(data, size));
+	#endif
+}
+
 template<typename T>
 struct DataValidate<std::string, typename std::enable_if<std::is_convertible<T, std::string>::value>::type, T> {
-	static void doIt(const char *varName, const std::string &value, const std::string &re) {
-		#ifdef PARMPARS_USE_REGEX
-		if (!std::regex_match(value, std::regex(re))) {
-		#else
-		if (!pattern(re).matches(value)) {
-		#endif
-			Alerts::error(StringBuilder()
+	static std::string check(const char *varName, const std::string &value, const std::string &re) {
+		if (!regexMatches(value.data(), value.size(), re)) {
+			return StringBuilder()
 				<< varName << " = \"" << value << "\" doesn\'t match regex "
-				<< "\"" << re << "\""
-			);
+				<< "\"" << re << "\"";
 		}
+		return "";
+	}
+	
+	static std::string describe(const std::string &re) {
+		return "{\"kind\": \"regex\", \"pattern\": " + Json::quote(re) + "}";
 	}
 };
 #endif
@@ -219,6 +845,16 @@ struct DataValidate<std::string, typename std::enable_if<std::is_convertible<T,
 
 template<typename T, typename = void> struct ReadFromString {};
 
+// The reason of the last failed conversion, if ReadFromString<T> can tell
+// it. It's added to the "Could not convert" message
+std::string conversionError;
+
+inline std::string conversionErrorText() {
+	std::string res = conversionError.empty() ? "" : ": " + conversionError;
+	conversionError.clear();
+	return res;
+}
+
 template<typename T>
 struct ReadFromString<T, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
 	static bool doIt(T &value, const std::string &str) {
@@ -307,31 +943,421 @@ namespace Variables {
 
 namespace Preprocessor {
 
-class Preprocessor {
-private:
-	std::map<std::string, std::string> variables_;
-public:
-	void define(const std::string &name, const std::string &value) {
-		if (!Variables::isValidName(name)) {
-			Alerts::error(StringBuilder()
-				<< "Macro \"" << name << "\" has invalid name"
-			);
+namespace Checked {
+	const long long minValue = LLONG_MIN;
+	const long long maxValue = LLONG_MAX;
+	
+	inline bool add(long long a, long long b, long long &res) {
+		if ((b > 0 && a > maxValue - b) || (b < 0 && a < minValue - b)) {
+			return false;
 		}
-		variables_[name] = value;
+		res = a + b;
+		return true;
 	}
 	
-	std::string preprocess(const std::string &line) const {
-		size_t len = line.size();
-		std::string res = "";
-		for (size_t i = 0; i < len;) {
-			if (line[i] != '@') {
-				res += line[i];
-				++i;
-				continue;
-			}
-			++i;
-			size_t p = i;
-			while (i < len && Variables::isValidMiddleChar(line[i])) {
+	inline bool sub(long long a, long long b, long long &res) {
+		if ((b < 0 && a > maxValue + b) || (b > 0 && a < minValue + b)) {
+			return false;
+		}
+		res = a - b;
+		return true;
+	}
+	
+	inline bool mul(long long a, long long b, long long &res) {
+		if (a > 0) {
+			if (b > 0 ? a > maxValue / b : b < minValue / a) {
+				return false;
+			}
+		} else if (a < 0) {
+			if (b > 0 ? a < minValue / b : b < maxValue / a) {
+				return false;
+			}
+		}
+		res = a * b;
+		return true;
+	}
+}
+
+// Integer expression like "n/2+1", compiled into a bytecode for a stack
+// machine. Supports +, -, *, /, %, unary minus and parentheses. Names refer to
+// macros or parsed numeric parameters
+class Expression {
+private:
+	enum class OpCode {
+		Push,
+		Load,
+		Add,
+		Sub,
+		Mul,
+		Div,
+		Mod,
+		Neg
+	};
+	
+	struct Instruction {
+		OpCode op;
+		long long value;  // constant for Push, index in names_ for Load
+	};
+	
+	std::vector<Instruction> code_;
+	std::vector<std::string> names_;
+	
+	// Recursive descent parser, which emits the instructions in postfix order
+	struct Compiler {
+		const std::string &text;
+		size_t pos;
+		Expression &expr;
+		std::string error;
+		
+		void skipSpaces() {
+			while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+				++pos;
+			}
+		}
+		
+		bool fail(const std::string &message) {
+			error = StringBuilder() << message << " at position " << pos;
+			return false;
+		}
+		
+		bool primary() {
+			skipSpaces();
+			if (pos >= text.size()) {
+				return fail("Unexpected end of expression");
+			}
+			char c = text[pos];
+			if (c == '(') {
+				++pos;
+				if (!sum()) {
+					return false;
+				}
+				skipSpaces();
+				if (pos >= text.size() || text[pos] != ')') {
+					return fail("Expected ')'");
+				}
+				++pos;
+				return true;
+			}
+			if (std::isdigit(static_cast<unsigned char>(c))) {
+				long long value = 0;
+				while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) {
+					if (!Checked::mul(value, 10, value) || !Checked::add(value, text[pos] - '0', value)) {
+						return fail("Integer overflow");
+					}
+					++pos;
+				}
+				expr.code_.push_back(Instruction {OpCode::Push, value});
+				return true;
+			}
+			if (Variables::isValidStartChar(c)) {
+				size_t start = pos;
+				while (pos < text.size() && Variables::isValidMiddleChar(text[pos])) {
+					++pos;
+				}
+				std::string name = text.substr(start, pos - start);
+				long long index = std::find(expr.names_.begin(), expr.names_.end(), name) - expr.names_.begin();
+				if (index == static_cast<long long>(expr.names_.size())) {
+					expr.names_.push_back(name);
+				}
+				expr.code_.push_back(Instruction {OpCode::Load, index});
+				return true;
+			}
+			return fail(StringBuilder() << "Unexpected character '" << c << "'");
+		}
+		
+		bool unary() {
+			skipSpaces();
+			if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) {
+				bool negate = text[pos] == '-';
+				++pos;
+				if (!unary()) {
+					return false;
+				}
+				if (negate) {
+					expr.code_.push_back(Instruction {OpCode::Neg, 0});
+				}
+				return true;
+			}
+			return primary();
+		}
+		
+		bool product() {
+			if (!unary()) {
+				return false;
+			}
+			while (true) {
+				skipSpaces();
+				if (pos >= text.size()) {
+					return true;
+				}
+				OpCode op;
+				switch (text[pos]) {
+					case '*': op = OpCode::Mul; break;
+					case '/': op = OpCode::Div; break;
+					case '%': op = OpCode::Mod; break;
+					default: return true;
+				}
+				++pos;
+				if (!unary()) {
+					return false;
+				}
+				expr.code_.push_back(Instruction {op, 0});
+			}
+		}
+		
+		bool sum() {
+			if (!product()) {
+				return false;
+			}
+			while (true) {
+				skipSpaces();
+				if (pos >= text.size() || (text[pos] != '+' && text[pos] != '-')) {
+					return true;
+				}
+				OpCode op = text[pos] == '+' ? OpCode::Add : OpCode::Sub;
+				++pos;
+				if (!product()) {
+					return false;
+				}
+				expr.code_.push_back(Instruction {op, 0});
+			}
+		}
+	};
+public:
+	const std::vector<std::string> &names() const {
+		return names_;
+	}
+	
+	bool compile(const std::string &text, std::string &error) {
+		code_.clear();
+		names_.clear();
+		Compiler compiler {text, 0, *this, ""};
+		bool ok = compiler.sum();
+		compiler.skipSpaces();
+		if (ok && compiler.pos != text.size()) {
+			ok = compiler.fail("Unexpected character");
+		}
+		if (!ok) {
+			error = StringBuilder() << "Invalid expression \"" << text << "\": " << compiler.error;
+		}
+		return ok;
+	}
+	
+	// values[i] is the value of names()[i]
+	bool evaluate(const std::vector<long long> &values, long long &res, std::string &error) const {
+		std::vector<long long> stack;
+		stack.reserve(code_.size());
+		for (const Instruction &instr: code_) {
+			if (instr.op == OpCode::Push) {
+				stack.push_back(instr.value);
+				continue;
+			}
+			if (instr.op == OpCode::Load) {
+				stack.push_back(values[instr.value]);
+				continue;
+			}
+			if (instr.op == OpCode::Neg) {
+				if (stack.back() == Checked::minValue) {
+					error = "Integer overflow";
+					return false;
+				}
+				stack.back() = -stack.back();
+				continue;
+			}
+			long long b = stack.back();
+			stack.pop_back();
+			long long &a = stack.back();
+			bool ok = true;
+			switch (instr.op) {
+				case OpCode::Add: {
+					ok = Checked::add(a, b, a);
+					break;
+				}
+				case OpCode::Sub: {
+					ok = Checked::sub(a, b, a);
+					break;
+				}
+				case OpCode::Mul: {
+					ok = Checked::mul(a, b, a);
+					break;
+				}
+				case OpCode::Div:
+				case OpCode::Mod: {
+					if (b == 0) {
+						error = "Division by zero";
+						return false;
+					}
+					if (b == -1) {
+						// Avoids overflow of LLONG_MIN / -1
+						ok = instr.op == OpCode::Mod || a != Checked::minValue;
+						a = instr.op == OpCode::Mod ? 0 : -a;
+					} else {
+						a = instr.op == OpCode::Div ? a / b : a % b;
+					}
+					break;
+				}
+				default: {
+					break;
+				}
+			}
+			if (!ok) {
+				error = "Integer overflow";
+				return false;
+			}
+		}
+		res = stack.back();
+		return true;
+	}
+};
+
+class Preprocessor {
+private:
+	struct CachedExpression {
+		Expression expr;
+		bool compiled;
+		std::string compileError;
+		long long value;
+		unsigned long long version;  // 0 if not evaluated yet
+	};
+	
+	std::map<std::string, std::string> variables_;
+	std::map<std::string, long long> parsedValues_;
+	mutable std::map<std::string, CachedExpression> expressions_;
+	// Incremented each time a macro or a parsed value changes, so the cached
+	// values of the expressions can be reused until then
+	unsigned long long version_ = 1;
+	
+	bool lookupNumber(const std::string &name, long long &value, std::string &error) const {
+		auto varIter = variables_.find(name);
+		if (varIter != end(variables_)) {
+			if (!ReadFromString<long long>::doIt(value, varIter->second)) {
+				error = StringBuilder()
+					<< "Macro \"" << name << "\" = \"" << varIter->second << "\" is not an integer";
+				return false;
+			}
+			return true;
+		}
+		auto parsedIter = parsedValues_.find(name);
+		if (parsedIter != end(parsedValues_)) {
+			value = parsedIter->second;
+			return true;
+		}
+		error = StringBuilder() << "Macro or numeric parameter \"" << name << "\" not found";
+		return false;
+	}
+	
+	CachedExpression &compiled(const std::string &text) const {
+		auto iter = expressions_.find(text);
+		if (iter == end(expressions_)) {
+			CachedExpression cached;
+			cached.compiled = cached.expr.compile(text, cached.compileError);
+			cached.version = 0;
+			iter = expressions_.emplace(text, cached).first;
+		}
+		return iter->second;
+	}
+	
+	bool evaluate(const std::string &text, long long &res, std::string &error) const {
+		CachedExpression &cached = compiled(text);
+		if (!cached.compiled) {
+			error = cached.compileError;
+			return false;
+		}
+		if (cached.version != version_) {
+			const std::vector<std::string> &names = cached.expr.names();
+			std::vector<long long> values(names.size());
+			for (size_t i = 0; i < names.size(); ++i) {
+				if (!lookupNumber(names[i], values[i], error)) {
+					return false;
+				}
+			}
+			std::string evalError;
+			if (!cached.expr.evaluate(values, cached.value, evalError)) {
+				error = StringBuilder() << "Could not evaluate \"" << text << "\": " << evalError;
+				return false;
+			}
+			cached.version = version_;
+		}
+		res = cached.value;
+		return true;
+	}
+public:
+	void define(const std::string &name, const std::string &value) {
+		if (!Variables::isValidName(name)) {
+			Alerts::error(StringBuilder()
+				<< "Macro \"" << name << "\" has invalid name"
+			);
+		}
+		variables_[name] = value;
+		++version_;
+	}
+	
+	// Makes the value of a numeric parameter available in the expressions
+	void setParsedValue(const std::string &name, long long value) {
+		auto iter = parsedValues_.find(name);
+		if (iter != end(parsedValues_) && iter->second == value) {
+			return;
+		}
+		parsedValues_[name] = value;
+		++version_;
+	}
+	
+	// Compiles the expressions in the line without evaluating them, so the
+	// copies of the preprocessor don't have to compile them again
+	void compileExpressions(const std::string &line) const {
+		size_t len = line.size();
+		for (size_t i = 0; i < len;) {
+			if (line[i] != '@') {
+				++i;
+				continue;
+			}
+			++i;
+			if (i < len && line[i] == '{') {
+				size_t closePos = line.find('}', i);
+				if (closePos == std::string::npos) {
+					return;
+				}
+				compiled(line.substr(i+1, closePos-i-1));
+				i = closePos + 1;
+				continue;
+			}
+			while (i < len && Variables::isValidMiddleChar(line[i])) {
+				++i;
+			}
+			if (i < len && line[i] == '!') {
+				++i;
+			}
+		}
+	}
+	
+	// Returns false and sets the error message if the line cannot be
+	// preprocessed
+	bool tryPreprocess(const std::string &line, std::string &res, std::string &error) const {
+		size_t len = line.size();
+		res = "";
+		for (size_t i = 0; i < len;) {
+			if (line[i] != '@') {
+				res += line[i];
+				++i;
+				continue;
+			}
+			++i;
+			if (i < len && line[i] == '{') {
+				size_t closePos = line.find('}', i);
+				if (closePos == std::string::npos) {
+					error = StringBuilder() << "Expression \"" << line.substr(i-1) << "\" is not closed";
+					return false;
+				}
+				long long value;
+				if (!evaluate(line.substr(i+1, closePos-i-1), value, error)) {
+					return false;
+				}
+				res += StringBuilder() << value;
+				i = closePos + 1;
+				continue;
+			}
+			size_t p = i;
+			while (i < len && Variables::isValidMiddleChar(line[i])) {
 				++i;
 			}
 			std::string varName = line.substr(p, i-p);
@@ -339,10 +1365,19 @@ public:
 				++i;
 			}
 			if (variables_.find(varName) == end(variables_)) {
-				Alerts::error(StringBuilder() << "Macro \"" << varName << "\" not found");
+				error = StringBuilder() << "Macro \"" << varName << "\" not found";
+				return false;
 			}
 			res += variables_.at(varName);
 		}
+		return true;
+	}
+	
+	std::string preprocess(const std::string &line) const {
+		std::string res, error;
+		if (!tryPreprocess(line, res, error)) {
+			Alerts::error(error);
+		}
 		return res;
 	}
 	
@@ -365,48 +1400,420 @@ namespace ValidateUtils {
 				return false;
 			}
 		}
-		return true;
+		return true;
+	}
+}
+
+
+namespace ParseUtils {
+	// Splits the string by commas. Commas inside brackets are not treated as
+	// separators, so the parts may contain ranges like [1,5]
+	inline bool splitTopLevel(const std::string &str, std::vector<std::string> &parts) {
+		parts.clear();
+		int depth = 0;
+		size_t start = 0;
+		for (size_t i = 0; i <= str.size(); ++i) {
+			if (i == str.size() || (str[i] == ',' && depth == 0)) {
+				parts.push_back(str.substr(start, i - start));
+				start = i+1;
+				continue;
+			}
+			if (str[i] == '[' || str[i] == '(') {
+				++depth;
+			} else if (str[i] == ']' || str[i] == ')') {
+				if (--depth < 0) {
+					return false;
+				}
+			}
+		}
+		return depth == 0;
+	}
+	
+	// Splits "key1:value1,key2:value2" into pairs. A field without ':' gets
+	// an empty key.
+	inline bool splitFields(
+		const std::string &str,
+		std::vector<std::pair<std::string, std::string>> &fields
+	) {
+		fields.clear();
+		std::vector<std::string> parts;
+		if (!splitTopLevel(str, parts)) {
+			return false;
+		}
+		for (const std::string &field: parts) {
+			if (field.empty()) {
+				return false;
+			}
+			size_t colonPos = field.find(':');
+			if (colonPos == std::string::npos) {
+				fields.emplace_back("", field);
+			} else {
+				fields.emplace_back(field.substr(0, colonPos), field.substr(colonPos+1));
+			}
+		}
+		return true;
+	}
+}
+
+
+template<typename T>
+struct ReadFromString<std::vector<T>> {
+	static bool doIt(std::vector<T> &value, const std::string &str) {
+		value.clear();
+		if (str.empty()) {
+			return true;
+		}
+		std::vector<std::string> parts;
+		if (!ParseUtils::splitTopLevel(str, parts)) {
+			return false;
+		}
+		value.resize(parts.size());
+		for (size_t i = 0; i < parts.size(); ++i) {
+			if (!ReadFromString<T>::doIt(value[i], parts[i])) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+
+template<typename T>
+struct TypeInfo {};
+
+#define PARMPARS_ADD_TYPE_NAME(type, name) \
+	template<> \
+	struct TypeInfo<type> { \
+		static std::string getTypeName() { \
+			return #name; \
+		} \
+	};
+
+#define PARMPARS_ADD_TYPE(type) PARMPARS_ADD_TYPE_NAME(type, type)
+
+PARMPARS_ADD_TYPE(bool)
+PARMPARS_ADD_TYPE(char)
+PARMPARS_ADD_TYPE(char16_t)
+PARMPARS_ADD_TYPE(char32_t)
+PARMPARS_ADD_TYPE(wchar_t)
+PARMPARS_ADD_TYPE(signed char)
+PARMPARS_ADD_TYPE(short)
+PARMPARS_ADD_TYPE(unsigned short)
+PARMPARS_ADD_TYPE(int)
+PARMPARS_ADD_TYPE(unsigned int)
+PARMPARS_ADD_TYPE(long)
+PARMPARS_ADD_TYPE(unsigned long)
+PARMPARS_ADD_TYPE(long long)
+PARMPARS_ADD_TYPE(unsigned long long)
+
+PARMPARS_ADD_TYPE(float)
+PARMPARS_ADD_TYPE(double)
+PARMPARS_ADD_TYPE(long double)
+
+PARMPARS_ADD_TYPE_NAME(std::string, string)
+
+template<typename T>
+struct TypeInfo<std::vector<T>> {
+	static std::string getTypeName() {
+		return "vector<" + TypeInfo<T>::getTypeName() + ">";
+	}
+};
+
+
+namespace FileMapping {
+	// Read-only contents of a file. On POSIX systems the file is mapped into
+	// memory, otherwise it's read into a buffer
+	class MappedFile {
+	private:
+		const char *data_ = nullptr;
+		size_t size_ = 0;
+		bool mapped_ = false;
+		std::string buffer_;
+	public:
+		const char *data() const {
+			return data_;
+		}
+		
+		size_t size() const {
+			return size_;
+		}
+		
+		// Returns false and sets the error message if the file cannot be read
+		bool open(const std::string &path, std::string &error) {
+			#ifdef _WIN32
+			std::ifstream in(path, std::ios::binary);
+			if (!in) {
+				error = StringBuilder() << "could not open file \"" << path << "\": " << std::strerror(errno);
+				return false;
+			}
+			std::ostringstream os;
+			os << in.rdbuf();
+			buffer_ = os.str();
+			data_ = buffer_.data();
+			size_ = buffer_.size();
+			return true;
+			#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) {
+				error = StringBuilder() << "could not open file \"" << path << "\": " << std::strerror(errno);
+				return false;
+			}
+			struct stat st;
+			if (fstat(fd, &st) != 0) {
+				error = StringBuilder() << "could not stat file \"" << path << "\": " << std::strerror(errno);
+				::close(fd);
+				return false;
+			}
+			if (!S_ISREG(st.st_mode)) {
+				error = StringBuilder() << "\"" << path << "\" is not a regular file";
+				::close(fd);
+				return false;
+			}
+			size_ = st.st_size;
+			if (size_ == 0) {
+				::close(fd);
+				data_ = buffer_.data();
+				return true;
+			}
+			void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			int mapErrno = errno;
+			::close(fd);
+			if (addr == MAP_FAILED) {
+				error = StringBuilder() << "could not map file \"" << path << "\": " << std::strerror(mapErrno);
+				return false;
+			}
+			data_ = static_cast<const char *>(addr);
+			mapped_ = true;
+			return true;
+			#endif
+		}
+		
+		MappedFile() {}
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+		
+		~MappedFile() {
+			#ifndef _WIN32
+			if (mapped_) {
+				munmap(const_cast<char *>(data_), size_);
+			}
+			#endif
+		}
+	};
+}
+
+// Read-only string parameter. It can be given inline or as "<file:path>", in
+// which case the file is mapped into memory and not copied. Copies of
+// TextView share the same data
+class TextView {
+private:
+	std::shared_ptr<const void> storage_;
+	const char *data_ = "";
+	size_t size_ = 0;
+	std::string source_;
+public:
+	const char *data() const {
+		return data_;
+	}
+	
+	size_t size() const {
+		return size_;
+	}
+	
+	bool empty() const {
+		return size_ == 0;
+	}
+	
+	const char *begin() const {
+		return data_;
+	}
+	
+	const char *end() const {
+		return data_ + size_;
+	}
+	
+	char operator[](size_t pos) const {
+		return data_[pos];
+	}
+	
+	// Either "<file:path>" or the value itself, used in error messages
+	const std::string &source() const {
+		return source_;
+	}
+	
+	std::string str() const {
+		return std::string(data_, size_);
+	}
+	
+	explicit operator std::string() const {
+		return str();
+	}
+	
+	static bool isFileSyntax(const std::string &str) {
+		const std::string prefix = "<file:";
+		return
+			str.size() > prefix.size() + 1 &&
+			str.compare(0, prefix.size(), prefix) == 0 &&
+			str.back() == '>'
+		;
+	}
+	
+	static bool fromFile(TextView &res, const std::string &path, std::string &error) {
+		std::shared_ptr<FileMapping::MappedFile> file = std::make_shared<FileMapping::MappedFile>();
+		if (!file->open(path, error)) {
+			return false;
+		}
+		res.data_ = file->data();
+		res.size_ = file->size();
+		res.storage_ = file;
+		res.source_ = "<file:" + path + ">";
+		return true;
+	}
+	
+	TextView() {}
+	
+	explicit TextView(const std::string &value)
+		: source_(value) {
+		std::shared_ptr<const std::string> str = std::make_shared<const std::string>(value);
+		data_ = str->data();
+		size_ = str->size();
+		storage_ = str;
+	}
+};
+
+inline std::ostream &operator<<(std::ostream &os, const TextView &value) {
+	return os.write(value.data(), value.size());
+}
+
+template<>
+struct ReadFromString<TextView> {
+	static bool doIt(TextView &value, const std::string &str) {
+		if (TextView::isFileSyntax(str)) {
+			return TextView::fromFile(value, str.substr(6, str.size() - 7), conversionError);
+		}
+		value = TextView(str);
+		return true;
+	}
+};
+
+PARMPARS_ADD_TYPE(TextView)
+
+#if defined(PARMPARS_USE_REGEX) || defined(USE_TESTLIB)
+template<typename T>
+struct DataValidate<TextView, typename std::enable_if<std::is_convertible<T, std::string>::value>::type, T> {
+	static std::string check(const char *varName, const TextView &value, const std::string &re) {
+		if (!regexMatches(value.data(), value.size(), re)) {
+			return StringBuilder()
+				<< varName << " = \"" << value.source() << "\" doesn\'t match regex "
+				<< "\"" << re << "\"";
+		}
+		return "";
+	}
+	
+	static std::string describe(const std::string &re) {
+		return DataValidate<std::string, void, std::string>::describe(re);
+	}
+};
+#endif
+
+
+namespace Schema {
+	// Placeholder values are returned by DECLARE in schema and script check
+	// modes, so the following declarations still get valid arguments. The
+	// lower bound is taken, so the generation code (if it's run) stays cheap
+	inline std::string placeholderText() {
+		return "1";
+	}
+	
+	template<typename R>
+	std::string placeholderText(const Range<R> &range) {
+		return StringBuilder() << range.left;
+	}
+	
+	template<typename T>
+	std::string placeholderText(const OneOf<T> &oneOf) {
+		if (oneOf.values().empty()) {
+			return "1";
+		}
+		return StringBuilder() << oneOf.values().front();
+	}
+	
+	template<typename M>
+	std::string placeholderText(const M &) {
+		return "1";
+	}
+	
+	// Makes the placeholder value of type T from the placeholder text. The
+	// types which cannot be read from a single number specialize it
+	template<typename T>
+	struct Placeholder {
+		static bool make(T &res, const std::string &text) {
+			return ReadFromString<T>::doIt(res, text);
+		}
+	};
+	
+	// Splits a line of the test script into tokens. Both single and double
+	// quotes are supported
+	inline std::vector<std::string> splitScriptLine(const std::string &line) {
+		std::vector<std::string> tokens;
+		std::string token;
+		bool hasToken = false;
+		char quote = 0;
+		for (char c: line) {
+			if (quote != 0) {
+				if (c == quote) {
+					quote = 0;
+				} else {
+					token += c;
+				}
+				continue;
+			}
+			if (c == '\'' || c == '"') {
+				quote = c;
+				hasToken = true;
+			} else if (std::isspace(static_cast<unsigned char>(c))) {
+				if (hasToken) {
+					tokens.push_back(token);
+				}
+				token.clear();
+				hasToken = false;
+			} else {
+				token += c;
+				hasToken = true;
+			}
+		}
+		if (hasToken) {
+			tokens.push_back(token);
+		}
+		return tokens;
 	}
 }
 
 
-template<typename T>
-struct TypeInfo {};
-
-#define PARMPARS_ADD_TYPE_NAME(type, name) \
-	template<> \
-	struct TypeInfo<type> { \
-		static std::string getTypeName() { \
-			return #name; \
-		} \
-	};
-
-#define PARMPARS_ADD_TYPE(type) PARMPARS_ADD_TYPE_NAME(type, type)
-
-PARMPARS_ADD_TYPE(bool)
-PARMPARS_ADD_TYPE(char)
-PARMPARS_ADD_TYPE(char16_t)
-PARMPARS_ADD_TYPE(char32_t)
-PARMPARS_ADD_TYPE(wchar_t)
-PARMPARS_ADD_TYPE(signed char)
-PARMPARS_ADD_TYPE(short)
-PARMPARS_ADD_TYPE(unsigned short)
-PARMPARS_ADD_TYPE(int)
-PARMPARS_ADD_TYPE(unsigned int)
-PARMPARS_ADD_TYPE(long)
-PARMPARS_ADD_TYPE(unsigned long)
-PARMPARS_ADD_TYPE(long long)
-PARMPARS_ADD_TYPE(unsigned long long)
-
-PARMPARS_ADD_TYPE(float)
-PARMPARS_ADD_TYPE(double)
-PARMPARS_ADD_TYPE(long double)
-
-PARMPARS_ADD_TYPE_NAME(std::string, string)
-
-
 class ParamParser {
 private:
+	enum class Mode {
+		Normal,
+		Schema,
+		CheckScript
+	};
+	
+	struct Declaration {
+		std::string name;
+		std::string typeName;
+		bool required;
+		std::string defaultValue;
+		std::string validation;
+	};
+	
+	// Types whose values can be used in the preprocessor expressions
+	template<typename T>
+	struct IsNumeric : std::integral_constant<bool,
+		std::is_integral<T>::value &&
+		!std::is_same<T, bool>::value &&
+		!std::is_same<T, char>::value
+	> {};
+	
 	struct VariableValue {
 		std::string value;
 		std::string lastType;
@@ -414,9 +1821,21 @@ private:
 		bool referenced;
 	};
 	
+	struct ScriptLine {
+		int lineNumber;
+		std::vector<std::string> args;
+	};
+	
 	bool loaded_ = false;
 	std::map<std::string, VariableValue> variables_;
 	Preprocessor::Preprocessor preprocessor_;
+	Mode mode_ = Mode::Normal;
+	std::string scriptFile_;
+	std::vector<ScriptLine> script_;
+	// Number of the script line checked by this process, or 0
+	int scriptLine_ = 0;
+	bool declarationsEnded_ = false;
+	std::vector<Declaration> declarations_;
 	
 	void checkLoaded() {
 		if (!loaded_) {
@@ -424,17 +1843,295 @@ private:
 		}
 	}
 	
+	// Parses the parameters like "name=value". For each invalid parameter,
+	// onError(paramNumber, message) is called and the parameter is skipped.
+	// Returns false if there were errors
+	static bool parseParams(
+		const std::vector<std::string> &args,
+		std::map<std::string, VariableValue> &variables,
+		const std::function<void(int, const std::string &)> &onError
+	) {
+		bool ok = true;
+		int count = args.size();
+		for (int idx = 1; idx <= count; ++idx) {
+			const std::string &param = args[idx-1];
+			if (param.empty()) {
+				continue;
+			}
+			if (ValidateUtils::isRandomSeed(param) && idx == count) {
+				continue;
+			}
+			std::size_t splitPos = param.find('=');
+			if (splitPos == std::string::npos) {
+				onError(idx, StringBuilder()
+					<< "Error while parsing parameter #" << idx << " : "
+					<< "\"" << param << "\" is not a valid variable!"
+				);
+				ok = false;
+				continue;
+			}
+			std::string varName = param.substr(0, splitPos);
+			std::string varValue = param.substr(splitPos+1);
+			if (!Variables::isValidName(varName)) {
+				onError(idx, StringBuilder()
+					<< "Error while parsing parameter #" << idx << " : "
+					<< "\"" << varName << "\" is invalid variable name!"
+				);
+				ok = false;
+				continue;
+			}
+			if (variables.find(varName) != end(variables)) {
+				onError(idx, StringBuilder()
+					<< "Error while parsing parameter #" << idx << " : "
+					<< "variable " << varName << " declared twice "
+					<< "(first declared in parameter #"
+					<< variables[varName].paramNumber << ")"
+				);
+				ok = false;
+				continue;
+			}
+			variables[varName] = VariableValue {varValue, "undefined", idx, false};
+		}
+		return ok;
+	}
+	
+	// Detects schema or script check mode. The reserved arguments are
+	// replaced with empty strings, so they are not treated as variables
+	void detectMode(std::vector<std::string> &args) {
+		const char *schemaEnv = std::getenv("PARMPARS_SCHEMA");
+		if (schemaEnv != nullptr && *schemaEnv != '\0' && std::string(schemaEnv) != "0") {
+			mode_ = Mode::Schema;
+		}
+		const char *checkEnv = std::getenv("PARMPARS_CHECK_SCRIPT");
+		if (checkEnv != nullptr && *checkEnv != '\0') {
+			mode_ = Mode::CheckScript;
+			scriptFile_ = checkEnv;
+		}
+		const std::string prefix = "--parmpars-";
+		const std::string checkArg = "--parmpars-check=";
+		for (std::string &arg: args) {
+			if (arg.compare(0, prefix.size(), prefix) != 0) {
+				continue;
+			}
+			if (arg == "--parmpars-schema") {
+				mode_ = Mode::Schema;
+			} else if (arg.compare(0, checkArg.size(), checkArg) == 0) {
+				mode_ = Mode::CheckScript;
+				scriptFile_ = arg.substr(checkArg.size());
+			} else {
+				Alerts::error(StringBuilder()
+					<< "Unknown reserved argument \"" << arg << "\""
+				);
+			}
+			arg.clear();
+		}
+		placeholderValues = mode_ == Mode::Schema;
+	}
+	
+	template<typename T, typename... ValidateMeans>
+	void declare(const char *varName, const T *defaultVal, ValidateMeans... means) {
+		for (const Declaration &decl: declarations_) {
+			if (decl.name == varName) {
+				return;
+			}
+		}
+		typedef DataValidate<T, void, ValidateMeans...> Validate;
+		Declaration decl;
+		decl.name = varName;
+		decl.typeName = TypeInfo<T>::getTypeName();
+		decl.required = defaultVal == nullptr;
+		if (defaultVal != nullptr) {
+			decl.defaultValue = StringBuilder() << *defaultVal;
+		}
+		decl.validation = Validate::describe(means...);
+		declarations_.push_back(decl);
+	}
+	
+	void printSchema() const {
+		std::cout << "{\"version\": " << Json::quote(PARMPARS_VERSION) << ", \"params\": [";
+		bool first = true;
+		for (const Declaration &decl: declarations_) {
+			std::cout << (first ? "\n" : ",\n") << "\t{"
+				<< "\"name\": " << Json::quote(decl.name) << ", "
+				<< "\"type\": " << Json::quote(decl.typeName) << ", "
+				<< "\"required\": " << (decl.required ? "true" : "false") << ", "
+				<< "\"default\": " << (decl.required ? "null" : Json::quote(decl.defaultValue)) << ", "
+				<< "\"validation\": " << decl.validation << "}";
+			first = false;
+		}
+		std::cout << "\n]}" << std::endl;
+	}
+	
+	// Reads the test script. Each line is like "gen n=10 m=[1,5] > $", the
+	// first token is the generator name. Returns false if the file cannot be
+	// opened
+	bool readScript() {
+		std::ifstream in(scriptFile_);
+		if (!in) {
+			return false;
+		}
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(in, line)) {
+			++lineNumber;
+			std::vector<std::string> tokens = Schema::splitScriptLine(line);
+			if (tokens.empty() || tokens[0][0] == '#') {
+				continue;
+			}
+			ScriptLine scriptLine {lineNumber, {}};
+			for (size_t i = 1; i < tokens.size() && tokens[i][0] != '>'; ++i) {
+				scriptLine.args.push_back(tokens[i]);
+			}
+			script_.push_back(scriptLine);
+		}
+		return true;
+	}
+	
+	void warnUnused() {
+		for (const auto &iter: variables_) {
+			const std::string &name = iter.first;
+			const VariableValue &value = iter.second;
+			if (!value.referenced) {
+				Alerts::ScopedContext context(name, value.paramNumber);
+				Alerts::warning(StringBuilder()
+					<< "Variable " << name << " is unused!"
+				);
+			}
+		}
+	}
+	
+	#ifndef _WIN32
+	// Prepares the child process to check the line: its alerts are written
+	// to the pipe and the output of the generator is discarded
+	void startScriptLine(const ScriptLine &scriptLine, int fd) {
+		mode_ = Mode::Normal;
+		scriptLine_ = scriptLine.lineNumber;
+		int devNull = ::open("/dev/null", O_WRONLY);
+		if (devNull >= 0) {
+			dup2(devNull, 1);
+			::close(devNull);
+		}
+		Alerts::sink.setScriptLine(scriptLine_, fdopen(fd, "w"));
+		Alerts::sink.setCollectErrors(true);
+	}
+	#endif
+	
+	// Checks all the lines of the test script. For each line, the generator
+	// is run in a child process up to params.endDeclarations() with the
+	// parameters of the line, so the validations which depend on other
+	// parameters (like range(1, n)) are built from the actual values. The
+	// parent process prints the result and exits, the child processes
+	// return the arguments of their line
+	std::vector<std::string> checkScript() {
+		#ifdef _WIN32
+		Alerts::error("Script check mode is not supported on Windows");
+		return {};
+		#else
+		for (const ScriptLine &scriptLine: script_) {
+			for (const std::string &arg: scriptLine.args) {
+				preprocessor_.compileExpressions(arg);
+			}
+		}
+		Alerts::sink.flush();
+		std::cout.flush();
+		std::fflush(stdout);
+		int lineCount = 0, errorCount = 0, warningCount = 0;
+		for (const ScriptLine &scriptLine: script_) {
+			++lineCount;
+			int fds[2];
+			if (pipe(fds) != 0) {
+				Alerts::error(StringBuilder() << "Could not create a pipe: " << std::strerror(errno));
+			}
+			pid_t pid = fork();
+			if (pid < 0) {
+				Alerts::error(StringBuilder() << "Could not start a process: " << std::strerror(errno));
+			}
+			if (pid == 0) {
+				::close(fds[0]);
+				startScriptLine(scriptLine, fds[1]);
+				return scriptLine.args;
+			}
+			::close(fds[1]);
+			std::string report;
+			char buffer[4096];
+			ssize_t count;
+			while ((count = read(fds[0], buffer, sizeof(buffer))) != 0) {
+				if (count > 0) {
+					report.append(buffer, count);
+				} else if (errno != EINTR) {
+					break;
+				}
+			}
+			::close(fds[0]);
+			int status = 0;
+			while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+			int lineErrors = 0;
+			const std::string severityKey = "\"severity\": ";
+			for (size_t pos = report.find(severityKey); pos != std::string::npos; pos = report.find(severityKey, pos + 1)) {
+				if (report.compare(pos + severityKey.size(), 7, "\"error\"") == 0) {
+					++lineErrors;
+				} else if (report.compare(pos + severityKey.size(), 9, "\"warning\"") == 0) {
+					++warningCount;
+				}
+			}
+			std::string failure;
+			if (WIFSIGNALED(status)) {
+				failure = StringBuilder() << "The generator was killed by signal " << WTERMSIG(status);
+			} else if (WEXITSTATUS(status) != 0 && lineErrors == 0) {
+				failure = StringBuilder() << "The generator exited with code " << WEXITSTATUS(status);
+			}
+			if (!failure.empty()) {
+				report += StringBuilder() << "{\"line\": " << scriptLine.lineNumber << ", "
+					<< "\"severity\": \"error\", \"variable\": null, "
+					<< "\"message\": " << Json::quote(failure) << "}\n";
+				++lineErrors;
+			}
+			std::cout << report;
+			errorCount += lineErrors;
+		}
+		std::cout << "{\"lines\": " << lineCount << ", "
+			<< "\"errors\": " << errorCount << ", "
+			<< "\"warnings\": " << warningCount << "}" << std::endl;
+		#ifdef PARMPARS_EXIT_ON_WARNING
+			errorCount += warningCount;
+		#endif
+		exit(errorCount == 0 ? 0 : 1);
+		#endif
+	}
+	
+	template<typename T>
+	typename std::enable_if<IsNumeric<T>::value>::type
+	exposeValue(const char *varName, const T &value) {
+		if (value > 0 && static_cast<unsigned long long>(value) > LLONG_MAX) {
+			return;
+		}
+		preprocessor_.setParsedValue(varName, static_cast<long long>(value));
+	}
+	
+	template<typename T>
+	typename std::enable_if<!IsNumeric<T>::value>::type
+	exposeValue(const char *, const T &) {}
+	
 	template<typename T, typename... ValidateMeans>
 	void internalGet(const char *varName, T &res, ValidateMeans... means) {
 		if (variables_.find(varName) != end(variables_)) {
 			std::string typeName = TypeInfo<T>::getTypeName();
 			VariableValue &varValue = variables_[varName];
-			std::string preprocessedValue = preprocessor_.preprocess(varValue.value);
-			if (!ReadFromString<T>::doIt(res, preprocessedValue)) {
+			std::string preprocessedValue, error;
+			bool converted = preprocessor_.tryPreprocess(varValue.value, preprocessedValue, error);
+			conversionError.clear();
+			if (!converted) {
+				Alerts::error(error);
+			} else if (!ReadFromString<T>::doIt(res, preprocessedValue)) {
 				Alerts::error(StringBuilder()
 					<< "Could not convert " << varName << " = \"" 
 					<< preprocessedValue << "\" to type " << typeName
+					<< conversionErrorText()
 				);
+				converted = false;
+			}
+			if (!converted) {
+				res = T();
 			}
 			if (!varValue.referenced) {
 				varValue.referenced = true;
@@ -447,17 +2144,37 @@ private:
 				}
 			}
 			varValue.lastType = typeName;
+			// If the errors are collected, don't report the invalid value again
+			if (!converted) {
+				return;
+			}
 		}
 		dataValidate(varName, res, means...);
+		exposeValue(varName, res);
+	}
+	
+	int paramNumber(const char *varName) const {
+		auto iter = variables_.find(varName);
+		return iter == end(variables_) ? 0 : iter->second.paramNumber;
 	}
 public:
 	template<typename T, typename... ValidateMeans>
 	void get(const char *varName, T &res, ValidateMeans... means) {
 		checkLoaded();
+		Alerts::ScopedContext context(varName, paramNumber(varName));
+		if (mode_ == Mode::Schema) {
+			declare(varName, static_cast<const T *>(nullptr), means...);
+			if (!Schema::Placeholder<T>::make(res, Schema::placeholderText(means...))) {
+				res = T();
+			}
+			return;
+		}
 		if (variables_.find(varName) == end(variables_)) {
 			Alerts::error(StringBuilder()
 				<< "Variable " << varName << " not found"
 			);
+			res = T();
+			return;
 		}
 		internalGet(varName, res, means...);
 	}
@@ -465,13 +2182,18 @@ public:
 	template<typename T, typename... ValidateMeans>
 	void getDefault(const char *varName, T &res, const T &defaultVal, ValidateMeans... means) {
 		checkLoaded();
+		Alerts::ScopedContext context(varName, paramNumber(varName));
 		res = defaultVal;
+		if (mode_ == Mode::Schema) {
+			declare(varName, &defaultVal, means...);
+			return;
+		}
 		internalGet(varName, res, means...);
 	}
 	
 	template<typename T, typename... ValidateMeans>
 	T get(const char *varName, ValidateMeans... means) {
-		T res;
+		T res = T();
 		get(varName, res, means...);
 		return res;
 	}
@@ -491,62 +2213,292 @@ public:
 	}
 	
 	void load(int argc, char *argv[]) {
-		for (int idx = 1; idx < argc; ++idx) {
-			std::string param = argv[idx]; 
-			if (param.empty()) {
-				continue;
-			}
-			if (ValidateUtils::isRandomSeed(param.c_str()) && idx == argc-1) {
-				continue;
-			}
-			std::size_t splitPos = param.find('=');
-			if (splitPos == std::string::npos) {
+		std::vector<std::string> args(argv + 1, argv + argc);
+		detectMode(args);
+		if (mode_ == Mode::CheckScript) {
+			if (!readScript()) {
 				Alerts::error(StringBuilder()
-					<< "Error while parsing parameter #" << idx << " : "
-					<< "\"" << param << "\" is not a valid variable!"
+					<< "Could not open script file \"" << scriptFile_ << "\""
 				);
 			}
-			std::string varName = param.substr(0, splitPos);
-			std::string varValue = param.substr(splitPos+1);
-			if (!Variables::isValidName(varName.c_str())) {
-				Alerts::error(StringBuilder()
-					<< "Error while parsing parameter #" << idx << " : "
-					<< "\"" << varName << "\" is invalid variable name!"
+			// Only the child processes return here
+			args = checkScript();
+		}
+		parseParams(args, variables_, [](int paramNumber, const std::string &message) {
+			Alerts::ScopedContext context("", paramNumber);
+			Alerts::error(message);
+		});
+		loaded_ = true;
+	}
+	
+	// Marks the end of the declarations. If the errors are collected, they
+	// are shown here and the program exits. In schema and script check modes,
+	// the program prints the result and exits here, so the generation code
+	// after this call is not run
+	void endDeclarations() {
+		checkLoaded();
+		if (scriptLine_ != 0) {
+			declarationsEnded_ = true;
+			warnUnused();
+			Alerts::sink.flush();
+			std::_Exit(0);
+		}
+		if (mode_ == Mode::Normal) {
+			Alerts::failOnErrors();
+			return;
+		}
+		if (declarationsEnded_) {
+			return;
+		}
+		declarationsEnded_ = true;
+		printSchema();
+		exit(0);
+	}
+	
+	~ParamParser() {
+		if (!loaded_ || Alerts::hadError) {
+			return;
+		}
+		if (mode_ == Mode::Schema) {
+			if (!declarationsEnded_) {
+				Alerts::warning(
+					"params.endDeclarations() was not called, so the generation code "
+					"was run with placeholder values"
 				);
+				printSchema();
+			}
+			return;
+		}
+		if (scriptLine_ != 0) {
+			Alerts::warning(
+				"params.endDeclarations() was not called, so the whole generator "
+				"was run to check the line"
+			);
+		}
+		warnUnused();
+	}
+};
+
+ParamParser params;
+
+
+class FastWriter;
+
+template<typename T, typename = void> struct WriteToBuffer {};
+
+class FastWriter {
+private:
+	static const size_t bufferSize = 1 << 20;
+	
+	std::vector<char> buffer_;
+	size_t pos_ = 0;
+	int fd_ = 1;
+	int precision_ = 6;
+	bool fixed_ = false;
+	
+	bool writeFd(const char *data, size_t size) {
+		if (fd_ == 1) {
+			std::fflush(stdout);
+		}
+		while (size > 0) {
+			#ifdef _WIN32
+			int written = _write(fd_, data, static_cast<unsigned>(size));
+			#else
+			ssize_t written = ::write(fd_, data, size);
+			#endif
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
 			}
-			if (variables_.find(varName) != end(variables_)) {
+			data += written;
+			size -= written;
+		}
+		return true;
+	}
+	
+	bool flushBuffer() {
+		size_t size = pos_;
+		pos_ = 0;
+		return writeFd(buffer_.data(), size);
+	}
+	
+	char *reserve(size_t size) {
+		if (buffer_.empty()) {
+			buffer_.resize(bufferSize);
+		}
+		if (bufferSize - pos_ < size) {
+			flush();
+		}
+		return buffer_.data() + pos_;
+	}
+public:
+	void flush() {
+		if (!flushBuffer()) {
+			Alerts::error(StringBuilder()
+				<< "Could not write the output to file descriptor " << fd_
+			);
+		}
+	}
+	
+	// Flushes the pending data and redirects the output to the given file
+	// descriptor. The descriptor is not closed by FastWriter
+	void setFd(int fd) {
+		flush();
+		fd_ = fd;
+	}
+	
+	// Floating point values are written with the given number of digits after
+	// the point. By default, they are written like std::ostream does
+	void setPrecision(int precision) {
+		fixed_ = true;
+		precision_ = precision;
+	}
+	
+	void writeChar(char c) {
+		*reserve(1) = c;
+		++pos_;
+	}
+	
+	void writeBytes(const char *data, size_t size) {
+		if (size >= bufferSize) {
+			flush();
+			if (!writeFd(data, size)) {
 				Alerts::error(StringBuilder()
-					<< "Error while parsing parameter #" << idx << " : "
-					<< "variable " << varName << " declared twice "
-					<< "(first declared in parameter #"
-					<< variables_[varName].paramNumber << ")"
+					<< "Could not write the output to file descriptor " << fd_
 				);
 			}
-			variables_[varName] = VariableValue {varValue, "undefined", idx, false};
+			return;
 		}
-		loaded_ = true;
+		std::memcpy(reserve(size), data, size);
+		pos_ += size;
 	}
 	
-	~ParamParser() {
-		if (!loaded_) {
+	template<typename T>
+	void writeInteger(T value) {
+		typedef typename std::make_unsigned<T>::type U;
+		char digits[24];
+		int len = 0;
+		U absValue = static_cast<U>(value);
+		bool negative = value < 0;
+		if (negative) {
+			absValue = U(0) - absValue;
+		}
+		do {
+			digits[len++] = '0' + absValue % 10;
+			absValue /= 10;
+		} while (absValue != 0);
+		char *out = reserve(len + 1);
+		if (negative) {
+			*out++ = '-';
+		}
+		while (len > 0) {
+			*out++ = digits[--len];
+		}
+		pos_ = out - buffer_.data();
+	}
+	
+	void writeFloat(long double value) {
+		const char *format = fixed_ ? "%.*Lf" : "%.*Lg";
+		char *out = reserve(64);
+		size_t avail = bufferSize - pos_;
+		int len = std::snprintf(out, avail, format, precision_, value);
+		if (len < 0) {
 			return;
 		}
-		if (Alerts::hadError) {
+		if (static_cast<size_t>(len) < avail) {
+			pos_ += len;
 			return;
 		}
-		for (const auto &iter: variables_) {
-			const std::string &name = iter.first;
-			const VariableValue &value = iter.second;
-			if (!value.referenced) {
-				Alerts::warning(StringBuilder()
-					<< "Variable " << name << " is unused!"
-				);
+		std::vector<char> str(len + 1);
+		std::snprintf(str.data(), str.size(), format, precision_, value);
+		writeBytes(str.data(), len);
+	}
+	
+	template<typename T>
+	FastWriter &operator<<(const T &value) {
+		WriteToBuffer<T>::doIt(*this, value);
+		return *this;
+	}
+	
+	FastWriter &operator<<(const char *value) {
+		writeBytes(value, std::strlen(value));
+		return *this;
+	}
+	
+	template<typename Iterator>
+	FastWriter &writeRange(Iterator first, Iterator last, char separator = ' ') {
+		for (Iterator iter = first; iter != last; ++iter) {
+			if (iter != first) {
+				writeChar(separator);
+			}
+			*this << *iter;
+		}
+		return *this;
+	}
+	
+	// Writes count values produced by generator.generate() (e. g. GenRange or
+	// GenRegex) without storing them
+	template<typename Generator>
+	FastWriter &writeGenerated(const Generator &generator, size_t count, char separator = ' ') {
+		for (size_t i = 0; i < count; ++i) {
+			if (i != 0) {
+				writeChar(separator);
 			}
+			*this << generator.generate();
 		}
+		return *this;
+	}
+	
+	~FastWriter() {
+		flushBuffer();
 	}
 };
 
-ParamParser params;
+template<typename T>
+struct WriteToBuffer<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+	static void doIt(FastWriter &writer, const T &value) {
+		writer.writeInteger(value);
+	}
+};
+
+template<>
+struct WriteToBuffer<char> {
+	static void doIt(FastWriter &writer, const char &value) {
+		writer.writeChar(value);
+	}
+};
+
+template<>
+struct WriteToBuffer<bool> {
+	static void doIt(FastWriter &writer, const bool &value) {
+		writer.writeChar(value ? '1' : '0');
+	}
+};
+
+template<typename T>
+struct WriteToBuffer<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+	static void doIt(FastWriter &writer, const T &value) {
+		writer.writeFloat(value);
+	}
+};
+
+template<>
+struct WriteToBuffer<std::string> {
+	static void doIt(FastWriter &writer, const std::string &value) {
+		writer.writeBytes(value.data(), value.size());
+	}
+};
+
+template<>
+struct WriteToBuffer<TextView> {
+	static void doIt(FastWriter &writer, const TextView &value) {
+		writer.writeBytes(value.data(), value.size());
+	}
+};
+
+FastWriter fastOutput;
 
 
 #ifdef USE_TESTLIB
@@ -693,6 +2645,52 @@ namespace TestLibAddon {
 			return rnd.next(pattern_);
 		}
 		
+		// Generates the same string as generate(), but passes it to
+		// sink(const char *data, size_t size) in chunks. For simple patterns
+		// (see SimpleRegex) the whole string is never stored in memory, as
+		// the random numbers are requested in the same order as Testlib does
+		template<typename Sink>
+		void generateTo(Sink &&sink) const {
+			checkLoaded();
+			std::vector<SimpleRegex::Item> items;
+			bool isSimple = SimpleRegex::parse(pattern_, items);
+			for (const SimpleRegex::Item &item: items) {
+				isSimple &= item.to != INT_MAX;
+			}
+			if (!isSimple) {
+				std::string str = generate();
+				sink(str.data(), str.size());
+				return;
+			}
+			const size_t chunkSize = 1 << 12;
+			char chunk[chunkSize];
+			size_t chunkPos = 0;
+			for (const SimpleRegex::Item &item: items) {
+				// Testlib doesn't request the count for the items like "x{0}"
+				if (item.to == 0) {
+					continue;
+				}
+				int count = rnd.next(item.to - item.from + 1) + item.from;
+				int charCount = item.chars.size();
+				for (int i = 0; i < count; ++i) {
+					chunk[chunkPos++] = item.chars[rnd.next(charCount)];
+					if (chunkPos == chunkSize) {
+						sink(static_cast<const char *>(chunk), chunkSize);
+						chunkPos = 0;
+					}
+				}
+			}
+			if (chunkPos != 0) {
+				sink(static_cast<const char *>(chunk), chunkPos);
+			}
+		}
+		
+		void generateTo(FastWriter &writer) const {
+			generateTo([&](const char *data, size_t size) {
+				writer.writeBytes(data, size);
+			});
+		}
+		
 		GenRegex() {}
 		
 		explicit GenRegex(const std::string &pattern)
@@ -710,12 +2708,597 @@ PARMPARS_ADD_TYPE_NAME(TestLibAddon::GenRegex, GenRegex)
 template<>
 struct ReadFromString<TestLibAddon::GenRegex> {
 	static bool doIt(TestLibAddon::GenRegex &value, const std::string &str) {
+		if (TextView::isFileSyntax(str)) {
+			TextView pattern;
+			if (!ReadFromString<TextView>::doIt(pattern, str)) {
+				return false;
+			}
+			value = TestLibAddon::GenRegex(pattern.str());
+			return true;
+		}
 		value = TestLibAddon::GenRegex(str);
 		return true;
 	}
 };
 
 
+namespace TestLibAddon {
+	namespace Sampling {
+		// long double keeps the indices exact for the populations up to 10^18
+		// on most platforms
+		typedef long double Real;
+		
+		const long long uniformBits = 1LL << 62;
+		
+		// Returns a random number in [0; 1)
+		inline Real uniform() {
+			return static_cast<Real>(rnd.next(uniformBits)) / uniformBits;
+		}
+		
+		// Returns a random number in (0; 1]
+		inline Real uniformPositive() {
+			return 1.0 - uniform();
+		}
+		
+		// Vitter's Algorithm A. Used for the tail of Algorithm D, when the
+		// population is not much larger than the sample
+		template<typename Callback>
+		void sampleSortedA(long long &current, long long population, long long count, Callback &select) {
+			Real top = population - count, popReal = population;
+			while (count >= 2) {
+				Real v = uniform();
+				long long skip = 0;
+				Real quot = top / popReal;
+				while (quot > v) {
+					++skip;
+					top -= 1.0;
+					popReal -= 1.0;
+					quot = quot * top / popReal;
+				}
+				current += skip + 1;
+				select(current);
+				population -= skip + 1;
+				popReal -= 1.0;
+				--count;
+			}
+			if (count == 1) {
+				long long skip = static_cast<long long>(population * uniform());
+				if (skip >= population) {
+					skip = population - 1;
+				}
+				current += skip + 1;
+				select(current);
+			}
+		}
+		
+		// Vitter's Algorithm D: selects count distinct indices from [0; population)
+		// in increasing order. Runs in O(count) expected time and needs no memory
+		template<typename Callback>
+		void sampleSorted(long long population, long long count, Callback select) {
+			const long long alphaInv = 13;
+			long long current = -1;
+			if (count <= 0) {
+				return;
+			}
+			Real countReal = count, countInv = 1.0 / countReal, popReal = population;
+			Real vPrime = std::exp(std::log(uniformPositive()) * countInv);
+			long long qu1 = population - count + 1;
+			Real qu1Real = qu1;
+			long long threshold = alphaInv * count;
+			while (count > 1 && threshold < population) {
+				Real countMin1Inv = 1.0 / (countReal - 1.0);
+				Real x, negSkipReal;
+				long long skip;
+				while (true) {
+					while (true) {
+						x = popReal * (1.0 - vPrime);
+						skip = static_cast<long long>(x);
+						if (skip < qu1) {
+							break;
+						}
+						vPrime = std::exp(std::log(uniformPositive()) * countInv);
+					}
+					Real u = uniformPositive();
+					negSkipReal = -skip;
+					Real y1 = std::exp(std::log(u * popReal / qu1Real) * countMin1Inv);
+					vPrime = y1 * (1.0 - x / popReal) * (qu1Real / (negSkipReal + qu1Real));
+					if (vPrime <= 1.0) {
+						break;
+					}
+					Real y2 = 1.0, top = popReal - 1.0, bottom;
+					long long limit;
+					if (count - 1 > skip) {
+						bottom = popReal - countReal;
+						limit = population - skip;
+					} else {
+						bottom = popReal + negSkipReal - 1.0;
+						limit = qu1;
+					}
+					for (long long t = population - 1; t >= limit; --t) {
+						y2 = y2 * top / bottom;
+						top -= 1.0;
+						bottom -= 1.0;
+					}
+					if (popReal / (popReal - x) >= y1 * std::exp(std::log(y2) * countMin1Inv)) {
+						vPrime = std::exp(std::log(uniformPositive()) * countMin1Inv);
+						break;
+					}
+					vPrime = std::exp(std::log(uniformPositive()) * countInv);
+				}
+				current += skip + 1;
+				select(current);
+				population -= skip + 1;
+				popReal += negSkipReal - 1.0;
+				--count;
+				countReal -= 1.0;
+				countInv = countMin1Inv;
+				qu1 -= skip;
+				qu1Real += negSkipReal;
+				threshold -= alphaInv;
+			}
+			if (count > 1) {
+				sampleSortedA(current, population, count, select);
+			} else {
+				long long skip = static_cast<long long>(population * vPrime);
+				if (skip >= population) {
+					skip = population - 1;
+				}
+				current += skip + 1;
+				select(current);
+			}
+		}
+	}
+	
+	struct Edge {
+		int from, to;
+	};
+	
+	// Vertices are numbered from 1 to vertexCount
+	struct EdgeList {
+		int vertexCount = 0;
+		std::vector<Edge> edges;
+		
+		// Randomly permutes the vertex labels, the edges and their endpoints
+		EdgeList &relabel() {
+			std::vector<int> perm(vertexCount + 1);
+			for (int i = 0; i <= vertexCount; ++i) {
+				perm[i] = i;
+			}
+			for (int i = 2; i <= vertexCount; ++i) {
+				std::swap(perm[i], perm[1 + rnd.next(i)]);
+			}
+			int edgeCount = edges.size();
+			for (int i = 1; i < edgeCount; ++i) {
+				std::swap(edges[i], edges[rnd.next(i+1)]);
+			}
+			for (Edge &edge: edges) {
+				edge.from = perm[edge.from];
+				edge.to = perm[edge.to];
+				if (rnd.next(2)) {
+					std::swap(edge.from, edge.to);
+				}
+			}
+			return *this;
+		}
+	};
+	
+	std::ostream &operator<<(std::ostream &os, const EdgeList &value) {
+		os << value.vertexCount << " " << value.edges.size() << "\n";
+		for (const Edge &edge: value.edges) {
+			os << edge.from << " " << edge.to << "\n";
+		}
+		return os;
+	}
+	
+	class GenTree {
+	public:
+		enum class Kind {
+			Random,
+			Path,
+			Star
+		};
+	private:
+		bool loaded_ = false;
+		Kind kind_;
+		GenRange<int> size_;
+		
+		void checkLoaded() const {
+			if (!loaded_) {
+				Alerts::error("GenTree is not loaded!");
+			}
+		}
+		
+		// Decodes a random Pruefer code in linear time
+		static void genRandom(EdgeList &res) {
+			int n = res.vertexCount;
+			if (n < 2) {
+				return;
+			}
+			std::vector<int> code(n-2), degree(n, 1);
+			for (int &v: code) {
+				v = rnd.next(n);
+				++degree[v];
+			}
+			int ptr = 0;
+			while (degree[ptr] != 1) {
+				++ptr;
+			}
+			int leaf = ptr;
+			for (int v: code) {
+				res.edges.push_back(Edge {leaf+1, v+1});
+				if (--degree[v] == 1 && v < ptr) {
+					leaf = v;
+				} else {
+					++ptr;
+					while (degree[ptr] != 1) {
+						++ptr;
+					}
+					leaf = ptr;
+				}
+			}
+			res.edges.push_back(Edge {leaf+1, n});
+		}
+	public:
+		static const char *kindName(Kind kind) {
+			switch (kind) {
+				case Kind::Random: return "random";
+				case Kind::Path: return "path";
+				case Kind::Star: return "star";
+			}
+			return "";
+		}
+		
+		Kind kind() const {
+			checkLoaded();
+			return kind_;
+		}
+		
+		const GenRange<int> &size() const {
+			checkLoaded();
+			return size_;
+		}
+		
+		EdgeList generate() const {
+			checkLoaded();
+			EdgeList res;
+			res.vertexCount = size_.generate();
+			if (res.vertexCount < 1) {
+				Alerts::error(StringBuilder()
+					<< "GenTree: cannot generate a tree with "
+					<< res.vertexCount << " vertices"
+				);
+			}
+			res.edges.reserve(res.vertexCount - 1);
+			switch (kind_) {
+				case Kind::Random: {
+					genRandom(res);
+					break;
+				}
+				case Kind::Path: {
+					for (int i = 1; i < res.vertexCount; ++i) {
+						res.edges.push_back(Edge {i, i+1});
+					}
+					break;
+				}
+				case Kind::Star: {
+					for (int i = 2; i <= res.vertexCount; ++i) {
+						res.edges.push_back(Edge {1, i});
+					}
+					break;
+				}
+			}
+			return res;
+		}
+		
+		GenTree() {}
+		
+		GenTree(Kind kind, const GenRange<int> &size)
+			: loaded_(true), kind_(kind), size_(size) {
+		}
+	};
+	
+	std::ostream &operator<<(std::ostream &os, const GenTree &value) {
+		return os << GenTree::kindName(value.kind()) << ":" << value.size();
+	}
+	
+	class GenGraph {
+	private:
+		bool loaded_ = false;
+		GenRange<int> vertices_;
+		GenRange<int> edges_;
+		
+		void checkLoaded() const {
+			if (!loaded_) {
+				Alerts::error("GenGraph is not loaded!");
+			}
+		}
+	public:
+		const GenRange<int> &vertices() const {
+			checkLoaded();
+			return vertices_;
+		}
+		
+		const GenRange<int> &edges() const {
+			checkLoaded();
+			return edges_;
+		}
+		
+		// Generates a uniformly random simple graph. Edges are sampled as
+		// distinct indices of the vertex pairs, so it takes O(n + m) time
+		EdgeList generate() const {
+			checkLoaded();
+			EdgeList res;
+			res.vertexCount = vertices_.generate();
+			int edgeCount = edges_.generate();
+			long long n = res.vertexCount;
+			long long maxEdges = n * (n-1) / 2;
+			if (n < 1 || edgeCount < 0 || edgeCount > maxEdges) {
+				Alerts::error(StringBuilder()
+					<< "GenGraph: cannot generate a simple graph with "
+					<< n << " vertices and " << edgeCount << " edges"
+				);
+			}
+			res.edges.reserve(edgeCount);
+			// Pairs (u, v), u < v, are numbered row by row
+			long long rowStart = 0;
+			int row = 1;
+			Sampling::sampleSorted(maxEdges, edgeCount, [&](long long index) {
+				while (index >= rowStart + (n - row)) {
+					rowStart += n - row;
+					++row;
+				}
+				res.edges.push_back(Edge {row, static_cast<int>(row + 1 + (index - rowStart))});
+			});
+			return res;
+		}
+		
+		GenGraph() {}
+		
+		GenGraph(const GenRange<int> &vertices, const GenRange<int> &edges)
+			: loaded_(true), vertices_(vertices), edges_(edges) {
+		}
+	};
+	
+	std::ostream &operator<<(std::ostream &os, const GenGraph &value) {
+		return os << "n:" << value.vertices() << ",m:" << value.edges();
+	}
+	
+	// Random composition of the sum into k parts, each of them is at least
+	// min. All the compositions are equally likely
+	class GenPartition {
+	private:
+		bool loaded_ = false;
+		GenRange<long long> sum_;
+		GenRange<int> count_;
+		long long minPart_;
+		
+		void checkLoaded() const {
+			if (!loaded_) {
+				Alerts::error("GenPartition is not loaded!");
+			}
+		}
+	public:
+		const GenRange<long long> &sum() const {
+			checkLoaded();
+			return sum_;
+		}
+		
+		const GenRange<int> &count() const {
+			checkLoaded();
+			return count_;
+		}
+		
+		long long minPart() const {
+			checkLoaded();
+			return minPart_;
+		}
+		
+		// Writes count parts into res. The parts minus (minPart - 1) are
+		// positive, so the cuts between them are count - 1 distinct points,
+		// which are sampled in increasing order in O(count) expected time
+		static void compose(long long sum, int count, long long minPart, long long *res) {
+			long long shift, total = sum;
+			bool ok = count >= 0 && minPart >= 0;
+			ok = ok && Preprocessor::Checked::mul(count, minPart - 1, shift);
+			ok = ok && Preprocessor::Checked::sub(sum, shift, total);
+			ok = ok && (count == 0 ? sum == 0 : total >= count);
+			if (!ok) {
+				Alerts::error(StringBuilder()
+					<< "GenPartition: cannot split " << sum << " into "
+					<< count << " parts of at least " << minPart
+				);
+				return;
+			}
+			if (count == 0) {
+				return;
+			}
+			long long prev = 0;
+			int pos = 0;
+			Sampling::sampleSorted(total - 1, count - 1, [&](long long index) {
+				long long cut = index + 1;
+				res[pos++] = cut - prev + (minPart - 1);
+				prev = cut;
+			});
+			res[pos] = total - prev + (minPart - 1);
+		}
+		
+		// Reuses the memory of res if possible
+		void generateTo(std::vector<long long> &res) const {
+			checkLoaded();
+			long long sum = sum_.generate();
+			int count = count_.generate();
+			if (count < 0) {
+				Alerts::error(StringBuilder()
+					<< "GenPartition: cannot split " << sum << " into " << count << " parts"
+				);
+				return;
+			}
+			res.resize(count);
+			compose(sum, count, minPart_, res.data());
+		}
+		
+		std::vector<long long> generate() const {
+			std::vector<long long> res;
+			generateTo(res);
+			return res;
+		}
+		
+		GenPartition() {}
+		
+		GenPartition(const GenRange<long long> &sum, const GenRange<int> &count, long long minPart = 1)
+			: loaded_(true), sum_(sum), count_(count), minPart_(minPart) {
+		}
+	};
+	
+	std::ostream &operator<<(std::ostream &os, const GenPartition &value) {
+		return os << "sum:" << value.sum() << ",k:" << value.count() << ",min:" << value.minPart();
+	}
+}
+
+PARMPARS_ADD_TYPE_NAME(TestLibAddon::GenTree, GenTree)
+PARMPARS_ADD_TYPE_NAME(TestLibAddon::GenGraph, GenGraph)
+PARMPARS_ADD_TYPE_NAME(TestLibAddon::GenPartition, GenPartition)
+
+template<>
+struct ReadFromString<TestLibAddon::GenTree> {
+	static bool doIt(TestLibAddon::GenTree &value, const std::string &str) {
+		using TestLibAddon::GenTree;
+		std::vector<std::pair<std::string, std::string>> fields;
+		if (!ParseUtils::splitFields(str, fields) || fields.size() != 1) {
+			return false;
+		}
+		const std::string &kindName = fields[0].first;
+		GenTree::Kind kind;
+		if (kindName.empty() || kindName == "random") {
+			kind = GenTree::Kind::Random;
+		} else if (kindName == "path") {
+			kind = GenTree::Kind::Path;
+		} else if (kindName == "star") {
+			kind = GenTree::Kind::Star;
+		} else {
+			return false;
+		}
+		TestLibAddon::GenRange<int> size;
+		if (!ReadFromString<TestLibAddon::GenRange<int>>::doIt(size, fields[0].second)) {
+			return false;
+		}
+		value = GenTree(kind, size);
+		return true;
+	}
+};
+
+template<>
+struct ReadFromString<TestLibAddon::GenGraph> {
+	static bool doIt(TestLibAddon::GenGraph &value, const std::string &str) {
+		std::vector<std::pair<std::string, std::string>> fields;
+		if (!ParseUtils::splitFields(str, fields)) {
+			return false;
+		}
+		TestLibAddon::GenRange<int> vertices, edges;
+		bool hasVertices = false, hasEdges = false;
+		for (const auto &field: fields) {
+			if (field.first == "n" && !hasVertices) {
+				hasVertices = ReadFromString<TestLibAddon::GenRange<int>>::doIt(vertices, field.second);
+				if (!hasVertices) {
+					return false;
+				}
+			} else if (field.first == "m" && !hasEdges) {
+				hasEdges = ReadFromString<TestLibAddon::GenRange<int>>::doIt(edges, field.second);
+				if (!hasEdges) {
+					return false;
+				}
+			} else {
+				return false;
+			}
+		}
+		if (!hasVertices || !hasEdges) {
+			return false;
+		}
+		value = TestLibAddon::GenGraph(vertices, edges);
+		return true;
+	}
+};
+
+template<>
+struct ReadFromString<TestLibAddon::GenPartition> {
+	static bool doIt(TestLibAddon::GenPartition &value, const std::string &str) {
+		std::vector<std::pair<std::string, std::string>> fields;
+		if (!ParseUtils::splitFields(str, fields)) {
+			return false;
+		}
+		TestLibAddon::GenRange<long long> sum;
+		TestLibAddon::GenRange<int> count;
+		long long minPart = 1;
+		bool hasSum = false, hasCount = false, hasMin = false;
+		for (const auto &field: fields) {
+			if (field.first == "sum" && !hasSum) {
+				hasSum = ReadFromString<TestLibAddon::GenRange<long long>>::doIt(sum, field.second);
+				if (!hasSum) {
+					return false;
+				}
+			} else if (field.first == "k" && !hasCount) {
+				hasCount = ReadFromString<TestLibAddon::GenRange<int>>::doIt(count, field.second);
+				if (!hasCount) {
+					return false;
+				}
+			} else if (field.first == "min" && !hasMin) {
+				hasMin = ReadFromString<long long>::doIt(minPart, field.second);
+				if (!hasMin || minPart < 0) {
+					return false;
+				}
+			} else {
+				return false;
+			}
+		}
+		if (!hasSum || !hasCount) {
+			return false;
+		}
+		value = TestLibAddon::GenPartition(sum, count, minPart);
+		return true;
+	}
+};
+
+namespace Schema {
+	template<>
+	struct Placeholder<TestLibAddon::GenGraph> {
+		static bool make(TestLibAddon::GenGraph &res, const std::string &text) {
+			return ReadFromString<TestLibAddon::GenGraph>::doIt(res, "n:" + text + ",m:0");
+		}
+	};
+	
+	template<>
+	struct Placeholder<TestLibAddon::GenPartition> {
+		static bool make(TestLibAddon::GenPartition &res, const std::string &) {
+			return ReadFromString<TestLibAddon::GenPartition>::doIt(res, "sum:1,k:1");
+		}
+	};
+}
+
+template<>
+struct InRange<int, TestLibAddon::GenTree> {
+	static bool doIt(const Range<int> &range, const TestLibAddon::GenTree &value) {
+		return inRange(range, value.size());
+	}
+};
+
+template<>
+struct InRange<int, TestLibAddon::GenGraph> {
+	static bool doIt(const Range<int> &range, const TestLibAddon::GenGraph &value) {
+		return inRange(range, value.vertices());
+	}
+};
+
+template<>
+struct WriteToBuffer<TestLibAddon::EdgeList> {
+	static void doIt(FastWriter &writer, const TestLibAddon::EdgeList &value) {
+		writer << value.vertexCount << ' ' << value.edges.size() << '\n';
+		for (const TestLibAddon::Edge &edge: value.edges) {
+			writer << edge.from << ' ' << edge.to << '\n';
+		}
+	}
+};
+
+
 namespace TestLibAddon {
 	void initGenerator(int argc, char *argv[], int randomGeneratorVersion) {
 		registerGen(argc, argv, randomGeneratorVersion);
@@ -731,12 +3314,22 @@ namespace TestLibAddon {
 using ParmParsInternal::Range;
 using ParmParsInternal::range;
 using ParmParsInternal::inRange;
+using ParmParsInternal::OneOf;
+using ParmParsInternal::oneOf;
+using ParmParsInternal::TextView;
 using ParmParsInternal::params;
+using ParmParsInternal::FastWriter;
+using ParmParsInternal::fastOutput;
 
 #ifdef USE_TESTLIB
 	using ParmParsInternal::TestLibAddon::GenRange;
 	using ParmParsInternal::TestLibAddon::genRange;
 	using ParmParsInternal::TestLibAddon::GenRegex;
+	using ParmParsInternal::TestLibAddon::GenTree;
+	using ParmParsInternal::TestLibAddon::GenGraph;
+	using ParmParsInternal::TestLibAddon::GenPartition;
+	using ParmParsInternal::TestLibAddon::Edge;
+	using ParmParsInternal::TestLibAddon::EdgeList;
 	using ParmParsInternal::TestLibAddon::initGenerator;
 #endif
 
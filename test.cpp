@@ -32,7 +32,8 @@ using namespace std;
 Example usage:
 	$ ./test i=1 l=2000111222 ll=-31513975719571 f=3.931 d=-13841.313 ld=-180e433 \
 	  c=a b=true s=hello ichk=20 schk=gepardo-debian 'ra=[1;5]' 'rachk=[1;100]' \
-	  're=lin[a-z]{1,2}-(mint|u[a-z]u[a-z][a-z]u)' unused=45 'igen=[1; 200]' wuovnowvwim
+	  're=lin[a-z]{1,2}-(mint|u[a-z]u[a-z][a-z]u)' unused=45 'igen=[1; 200]' \
+	  slong=abcdefghijklmnopqrstuvwxyz sdisj=ab7 sfall=ba wuovnowvwim
 Output:
 	i = 1
 	l = 2000111222
@@ -54,6 +55,10 @@ Output:
 	sdchk = hello
 	sgen = uayiiuie
 	igen = 108
+	sstream = [a-z]{0}[0-9]{2,5}x{0,3} same
+	slong = abcdefghijklmnopqrstuvwxyz
+	sdisj = ab7
+	sfall = ba
 	Warning: Variable unused is unused!
 */
 
@@ -79,6 +84,13 @@ int main(int argc, char **argv) {
 	DECLARE_D(string, sdchk, "hello", "h.l.{1,5}");
 	DECLARE_GEN_D(GenRegex, sgen, GenRegex("[aoueiy]{3,8}"));
 	DECLARE_GEN(GenRange<int>, igen, range(1, 200));
+	DECLARE_D(GenRegex, sstream, GenRegex("[a-z]{0}[0-9]{2,5}x{0,3}"));
+	// Simple regexes are checked without the regex engine: the long strings
+	// are matched by blocks of 16 characters, and the patterns like "a?b?a",
+	// where the greedy match may be wrong, fall back to the regex engine
+	DECLARE(string, slong, "[a-z]{1,40}");
+	DECLARE(string, sdisj, "[a-z]{1,3}[0-9]");
+	DECLARE(string, sfall, "a?b?a");
 	cout << "i = " << i << endl;
 	cout << "l = " << l << endl;
 	cout << "ll = " << ll << endl;
@@ -99,5 +111,16 @@ int main(int argc, char **argv) {
 	cout << "sdchk = " << sdchk << endl;
 	cout << "sgen = " << sgen << endl;
 	cout << "igen = " << igen << endl;
+	rnd.setSeed(42);
+	string generated = sstream.generate();
+	rnd.setSeed(42);
+	string streamed;
+	sstream.generateTo([&](const char *data, size_t size) {
+		streamed.append(data, size);
+	});
+	cout << "sstream = " << sstream << " " << (generated == streamed ? "same" : "different") << endl;
+	cout << "slong = " << slong << endl;
+	cout << "sdisj = " << sdisj << endl;
+	cout << "sfall = " << sfall << endl;
 	return 0;
 }
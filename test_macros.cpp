@@ -5,13 +5,17 @@ using namespace std;
 
 /*
 Example usage:
-	$ ./test_macros s1='@var1, world!' s2='@var1@var2' s3='@var1!1' s4='@@@' s5='@!var1'
+	$ ./test_macros s1='@var1, world!' s2='@var1@var2' s3='@var1!1' s4='@@@' s5='@!var1' \
+	  n=10 s6='@{var2*2+n/3}' s7='@!{n}'
 Output:
 	s1 = hello, world!
 	s2 = hello42
 	s3 = hello1
 	s4 = @@@
 	s5 = @var1
+	n = 10
+	s6 = 87
+	s7 = @{n}
 */
 
 int main(int argc, char **argv) {
@@ -24,12 +28,18 @@ int main(int argc, char **argv) {
 	DECLARE_D(string, s3, "");
 	DECLARE_D(string, s4, "");
 	DECLARE_D(string, s5, "");
+	DECLARE_D(int, n, 0);
+	DECLARE_D(string, s6, "");
+	DECLARE_D(string, s7, "");
 	
 	cout << "s1 = " << s1 << endl;
 	cout << "s2 = " << s2 << endl;
 	cout << "s3 = " << s3 << endl;
 	cout << "s4 = " << s4 << endl;
 	cout << "s5 = " << s5 << endl;
+	cout << "n = " << n << endl;
+	cout << "s6 = " << s6 << endl;
+	cout << "s7 = " << s7 << endl;
 	
 	return 0;
 } 